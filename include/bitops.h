@@ -1,3 +1,6 @@
+#ifndef BITOPS_H
+#define BITOPS_H
+
 #ifdef CONFIG_64BIT
 #define BITS_PER_LONG 64
 #else
@@ -35,3 +38,37 @@
 #define NBITS(n) (n==0?0:NBITS32(n))
 
 #define EXTRACT_NBITS(nr, h, l) ((nr&GENMASK(h,l)) >> l)
+
+/*
+ * Bitmap helpers, a bitmap is an array of unsigned long where each word
+ * carries BITS_PER_LONG bits (see BIT_WORD/BIT_MASK above)
+ */
+#define BITS_TO_WORDS(nr)       DIV_ROUND_UP(nr, BITS_PER_LONG)
+
+static inline void set_bit(int nr, unsigned long *addr)
+{
+	addr[BIT_WORD(nr)] |= BIT_MASK(nr);
+}
+
+static inline void clear_bit(int nr, unsigned long *addr)
+{
+	addr[BIT_WORD(nr)] &= ~BIT_MASK(nr);
+}
+
+static inline int test_bit(int nr, const unsigned long *addr)
+{
+	return (addr[BIT_WORD(nr)] & BIT_MASK(nr)) != 0;
+}
+
+/* Return the index of the lowest set bit, or @size if none is set */
+static inline int find_first_bit(const unsigned long *addr, int size)
+{
+	int i;
+
+	for (i = 0; i < BITS_TO_WORDS(size); i++)
+		if (addr[i])
+			return i * BITS_PER_LONG + __builtin_ctzl(addr[i]);
+	return size;
+}
+
+#endif
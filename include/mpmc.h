@@ -0,0 +1,44 @@
+
+#ifndef MPMC_H
+#define MPMC_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include "common.h"
+
+#define CACHE_LINE_SIZE 64
+
+/*
+ * Bounded lock-free multi-producer/multi-consumer queue of PCBs
+ * (array based, each cell carries a sequence number telling whether it
+ * is ready to be written or read in the current lap of the ring).
+ * Push and pop never block; they fail when the queue is full or empty.
+ */
+struct mpmc_cell_t {
+	atomic_size_t seq;
+	struct pcb_t * proc;
+};
+
+struct mpmc_queue_t {
+	struct mpmc_cell_t * cell;
+	size_t mask;
+	_Alignas(CACHE_LINE_SIZE) atomic_size_t enq_pos;
+	_Alignas(CACHE_LINE_SIZE) atomic_size_t deq_pos;
+};
+
+/* [capacity] is rounded up to a power of two */
+void mpmc_init(struct mpmc_queue_t * q, size_t capacity);
+
+void mpmc_destroy(struct mpmc_queue_t * q);
+
+/* Return 0 on success, 1 if the queue is full */
+int mpmc_push(struct mpmc_queue_t * q, struct pcb_t * proc);
+
+/* Return NULL if the queue is empty */
+struct pcb_t * mpmc_pop(struct mpmc_queue_t * q);
+
+/* Number of queued processes, only a hint under concurrency */
+size_t mpmc_size(struct mpmc_queue_t * q);
+
+#endif
+
@@ -4,11 +4,16 @@
 
 #include "common.h"
 
-#define MAX_QUEUE_SIZE 10
+/* Initial capacity of a queue, it doubles whenever the queue is full */
+#define QUEUE_INIT_SIZE 16
 
+/* Ring buffer of PCBs: [size] elements starting at proc[head],
+ * wrapping around at [capacity]. A zeroed queue is a valid empty queue */
 struct queue_t {
-	struct pcb_t * proc[MAX_QUEUE_SIZE];
+	struct pcb_t ** proc;
+	int head;
 	int size;
+	int capacity;
 };
 
 void enqueue(struct queue_t * q, struct pcb_t * proc);
@@ -17,5 +22,8 @@ struct pcb_t * dequeue(struct queue_t * q);
 
 int empty(struct queue_t * q);
 
+/* Release the storage of [q], its processes are not freed */
+void free_queue(struct queue_t * q);
+
 #endif
 
@@ -1,5 +1,5 @@
-#ifndef QUEUE_H
-#define QUEUE_H
+#ifndef SCHED_H
+#define SCHED_H
 
 #include "common.h"
 
@@ -7,20 +7,20 @@
 #define MLQ_SCHED
 #endif
 
-#define MAX_PRIO 139
-
 int queue_empty(void);
 
-void init_scheduler(void);
+/* Set up one run queue per CPU, CPUs are numbered 0 .. num_cpus - 1 */
+void init_scheduler(int num_cpus);
 void finish_scheduler(void);
 
-/* Get the next process from ready queue */
-struct pcb_t * get_proc(void);
+/* Get the next process for [cpu], stealing from another CPU
+ * when its own run queue is empty */
+struct pcb_t * get_proc(int cpu);
 
-/* Put a process back to run queue */
-void put_proc(struct pcb_t * proc);
+/* Put a process back to the run queue of [cpu] */
+void put_proc(int cpu, struct pcb_t * proc);
 
-/* Add a new process to ready queue */
+/* Add a new process to the least loaded CPU */
 void add_proc(struct pcb_t * proc);
 
 #endif
@@ -0,0 +1,88 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "mpmc.h"
+
+void mpmc_init(struct mpmc_queue_t * q, size_t capacity) {
+	size_t size = 2;
+	size_t i;
+
+	while (size < capacity)
+		size <<= 1;
+	q->cell = (struct mpmc_cell_t *)malloc(sizeof(struct mpmc_cell_t) * size);
+	if (q->cell == NULL) {
+		printf("Cannot allocate lock-free queue of %zu processes\n", size);
+		exit(1);
+	}
+	q->mask = size - 1;
+	for (i = 0; i < size; i++)
+		atomic_init(&q->cell[i].seq, i);
+	atomic_init(&q->enq_pos, 0);
+	atomic_init(&q->deq_pos, 0);
+}
+
+void mpmc_destroy(struct mpmc_queue_t * q) {
+	free(q->cell);
+	q->cell = NULL;
+}
+
+int mpmc_push(struct mpmc_queue_t * q, struct pcb_t * proc) {
+	struct mpmc_cell_t * cell;
+	size_t pos = atomic_load_explicit(&q->enq_pos, memory_order_relaxed);
+
+	for (;;) {
+		cell = &q->cell[pos & q->mask];
+		size_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+		intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+		if (dif == 0) {
+			/* Cell is free in this lap, try to claim it */
+			if (atomic_compare_exchange_weak_explicit(&q->enq_pos,
+					&pos, pos + 1,
+					memory_order_relaxed, memory_order_relaxed))
+				break;
+		} else if (dif < 0) {
+			/* Cell still holds the previous lap: full */
+			return 1;
+		} else {
+			pos = atomic_load_explicit(&q->enq_pos, memory_order_relaxed);
+		}
+	}
+	cell->proc = proc;
+	/* Publish the cell to consumers */
+	atomic_store_explicit(&cell->seq, pos + 1, memory_order_release);
+	return 0;
+}
+
+struct pcb_t * mpmc_pop(struct mpmc_queue_t * q) {
+	struct mpmc_cell_t * cell;
+	size_t pos = atomic_load_explicit(&q->deq_pos, memory_order_relaxed);
+
+	for (;;) {
+		cell = &q->cell[pos & q->mask];
+		size_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+		intptr_t dif = (intptr_t)seq - (intptr_t)(pos + 1);
+		if (dif == 0) {
+			/* Cell is published, try to claim it */
+			if (atomic_compare_exchange_weak_explicit(&q->deq_pos,
+					&pos, pos + 1,
+					memory_order_relaxed, memory_order_relaxed))
+				break;
+		} else if (dif < 0) {
+			/* Nothing published yet: empty */
+			return NULL;
+		} else {
+			pos = atomic_load_explicit(&q->deq_pos, memory_order_relaxed);
+		}
+	}
+	struct pcb_t * proc = cell->proc;
+	/* Hand the cell back to producers for the next lap */
+	atomic_store_explicit(&cell->seq, pos + q->mask + 1, memory_order_release);
+	return proc;
+}
+
+size_t mpmc_size(struct mpmc_queue_t * q) {
+	size_t enq = atomic_load_explicit(&q->enq_pos, memory_order_relaxed);
+	size_t deq = atomic_load_explicit(&q->deq_pos, memory_order_relaxed);
+	return enq > deq ? enq - deq : 0;
+}
+
@@ -7,23 +7,44 @@ int empty(struct queue_t * q) {
 	return (q->size == 0);
 }
 
-void enqueue(struct queue_t * q, struct pcb_t * proc) {
-        /* TODO: put a new process to queue [q] */
-        if (q->size < MAX_QUEUE_SIZE){
-		q->proc[q->size] = proc;
-		q->size++;
+/* Double the capacity of [q], unrolling the ring so that
+ * the oldest process sits at index 0 */
+static void grow_queue(struct queue_t * q) {
+	int capacity = q->capacity ? q->capacity * 2 : QUEUE_INIT_SIZE;
+	struct pcb_t ** proc =
+		(struct pcb_t **)malloc(sizeof(struct pcb_t *) * capacity);
+	if (proc == NULL) {
+		printf("Cannot grow queue to %d processes\n", capacity);
+		exit(1);
 	}
+	int i;
+	for (i = 0; i < q->size; i++)
+		proc[i] = q->proc[(q->head + i) % q->capacity];
+	free(q->proc);
+	q->proc = proc;
+	q->head = 0;
+	q->capacity = capacity;
+}
+
+void enqueue(struct queue_t * q, struct pcb_t * proc) {
+	if (q->size == q->capacity)
+		grow_queue(q);
+	q->proc[(q->head + q->size) % q->capacity] = proc;
+	q->size++;
 }
+
 struct pcb_t * dequeue(struct queue_t * q) {
-        /* TODO: return a pcb whose prioprity is the highest
-         * in the queue [q] and remember to remove it from q
-         * */
-	if(q->size == 0) return NULL;
-        struct pcb_t *max_prio_proc = q->proc[0];
-        for(int i = 1; i < q->size; i++) {
-        	q->proc[i-1] = q->proc[i]; 
-        }
-        q->size--;
-	return max_prio_proc;
+	/* Processes leave in the order they were enqueued */
+	if (q->size == 0) return NULL;
+	struct pcb_t * proc = q->proc[q->head];
+	q->head = (q->head + 1) % q->capacity;
+	q->size--;
+	return proc;
+}
+
+void free_queue(struct queue_t * q) {
+	free(q->proc);
+	q->proc = NULL;
+	q->head = q->size = q->capacity = 0;
 }
 
@@ -1,7 +1,9 @@
-
 #include "queue.h"
 #include "sched.h"
+#include "mpmc.h"
+#include "bitops.h"
 #include <pthread.h>
+#include <stdatomic.h>
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -10,99 +12,227 @@ static struct queue_t run_queue;
 static pthread_mutex_t queue_lock;
 
 #ifdef MLQ_SCHED
-static struct queue_t mlq_ready_queue[MAX_PRIO];
+/* Capacity of the lock-free admission queue of each CPU */
+#define INBOX_SIZE 1024
+
+/*
+ * Per-CPU MLQ run queue. Each CPU serves its own queues under its own
+ * lock, so CPUs only meet each other when a new process is placed or
+ * when an idle CPU steals work.
+ * Newly admitted processes are handed over through [inbox] without
+ * taking [lock]; the owner drains it into its MLQ queues.
+ */
+struct rq_t {
+	pthread_mutex_t lock;
+	struct mpmc_queue_t inbox;
+	struct queue_t mlq_ready_queue[MAX_PRIO];
+	/* Bit [prio] is set iff mlq_ready_queue[prio] is not empty */
+	unsigned long mlq_bitmap[BITS_TO_WORDS(MAX_PRIO)];
+	/* MLQ policy state, see get_mlq_proc() */
+	int prio;
+	int num_slot;
+	/* Load seen by other CPUs without taking [lock] */
+	atomic_int nr_ready;
+	atomic_int running;
+};
+
+static struct rq_t * cpu_rq;
+static int nr_cpus;
+/* Rotates the first candidate when several CPUs are equally loaded */
+static atomic_uint place_cursor;
+
+static void mlq_enqueue(struct rq_t * rq, struct pcb_t * proc) {
+	enqueue(&rq->mlq_ready_queue[proc->prio], proc);
+	set_bit(proc->prio, rq->mlq_bitmap);
+	atomic_fetch_add(&rq->nr_ready, 1);
+}
+
+static struct pcb_t * mlq_dequeue(struct rq_t * rq, int prio) {
+	struct pcb_t * proc = dequeue(&rq->mlq_ready_queue[prio]);
+	if (empty(&rq->mlq_ready_queue[prio]))
+		clear_bit(prio, rq->mlq_bitmap);
+	atomic_fetch_sub(&rq->nr_ready, 1);
+	return proc;
+}
+
+static int rq_load(struct rq_t * rq) {
+	return atomic_load(&rq->nr_ready) + (int)mpmc_size(&rq->inbox)
+		+ atomic_load(&rq->running);
+}
+
+/* Move the admitted processes into the MLQ queues.
+ * Caller must hold rq->lock. */
+static void drain_inbox(struct rq_t * rq) {
+	struct pcb_t * proc;
+	while ((proc = mpmc_pop(&rq->inbox)) != NULL)
+		mlq_enqueue(rq, proc);
+}
 #endif
 
 int queue_empty(void) {
 #ifdef MLQ_SCHED
-	unsigned long prio;
-	for (prio = 0; prio < MAX_PRIO; prio++)
-		if(!empty(&mlq_ready_queue[prio])) 
+	int cpu;
+	for (cpu = 0; cpu < nr_cpus; cpu++)
+		if (atomic_load(&cpu_rq[cpu].nr_ready)
+				|| mpmc_size(&cpu_rq[cpu].inbox))
 			return -1;
 #endif
 	return (empty(&ready_queue) && empty(&run_queue));
 }
 
-void init_scheduler(void) {
+void init_scheduler(int num_cpus) {
 #ifdef MLQ_SCHED
-	int i ;
+	int cpu;
 
-	for (i = 0; i < MAX_PRIO; i ++)
-		mlq_ready_queue[i].size = 0;
+	nr_cpus = num_cpus;
+	cpu_rq = (struct rq_t *)calloc(nr_cpus, sizeof(struct rq_t));
+	for (cpu = 0; cpu < nr_cpus; cpu++) {
+		pthread_mutex_init(&cpu_rq[cpu].lock, NULL);
+		mpmc_init(&cpu_rq[cpu].inbox, INBOX_SIZE);
+		cpu_rq[cpu].prio = 0;
+		cpu_rq[cpu].num_slot = MAX_PRIO;
+	}
+	atomic_store(&place_cursor, 0);
 #endif
 	ready_queue.size = 0;
 	run_queue.size = 0;
 	pthread_mutex_init(&queue_lock, NULL);
 }
 
+void finish_scheduler(void) {
 #ifdef MLQ_SCHED
-/* 
+	int cpu, prio;
+
+	for (cpu = 0; cpu < nr_cpus; cpu++) {
+		for (prio = 0; prio < MAX_PRIO; prio++)
+			free_queue(&cpu_rq[cpu].mlq_ready_queue[prio]);
+		mpmc_destroy(&cpu_rq[cpu].inbox);
+		pthread_mutex_destroy(&cpu_rq[cpu].lock);
+	}
+	free(cpu_rq);
+	cpu_rq = NULL;
+	nr_cpus = 0;
+#endif
+	free_queue(&ready_queue);
+	free_queue(&run_queue);
+	pthread_mutex_destroy(&queue_lock);
+}
+
+#ifdef MLQ_SCHED
+/*
  *  Stateful design for routine calling
  *  based on the priority and our MLQ policy
  *  We implement stateful here using transition technique
  *  State representation   prio = 0 .. MAX_PRIO, curr_slot = 0..(MAX_PRIO - prio)
+ *
+ *  The occupancy bitmap replaces the scan over every level:
+ *   - the current level keeps being served while it has a process
+ *     and slot budget left,
+ *   - a non-empty level below the current one takes over and
+ *     inherits the remaining budget,
+ *   - otherwise we move up to the first non-empty level and get
+ *     a fresh budget of MAX_PRIO - prio slots.
+ *
+ *  Caller must hold rq->lock.
  */
-struct pcb_t *get_mlq_proc(void)
+static struct pcb_t *get_mlq_proc(struct rq_t * rq)
 {
-	struct pcb_t *proc = NULL;
-	static int prio = 0;
-	static int num_slot = MAX_PRIO;
-	pthread_mutex_lock(&queue_lock);
-	for (int i=0; i<MAX_PRIO; i++) {
-		int set = 0;
-		if (!empty(&mlq_ready_queue[prio])) {
-			proc = dequeue(&mlq_ready_queue[prio]);
-			num_slot--;
-			if (num_slot <= 0) {
-				prio++;
-				if (prio >= MAX_PRIO) prio = 0;
-				num_slot = MAX_PRIO - prio; 
-			}
-			break;
-		}
-		else {
-			for (int j=0; j<prio; j++) {
-				if (!empty(&mlq_ready_queue[j])) {
-					prio=j;
-					set=1;
-				}		
-			}
-		}
-		if ( set==0 ) {
-			prio++;
-			if (prio >= MAX_PRIO) prio = 0;
-			num_slot = MAX_PRIO - prio;
-		}
+	int first = find_first_bit(rq->mlq_bitmap, MAX_PRIO);
+	struct pcb_t *proc;
+
+	if (first >= MAX_PRIO) {
+		/* Nothing to run, the budget of current level is refilled */
+		rq->num_slot = MAX_PRIO - rq->prio;
+		return NULL;
+	}
+	if (!test_bit(rq->prio, rq->mlq_bitmap)) {
+		if (first > rq->prio)
+			rq->num_slot = MAX_PRIO - first;
+		rq->prio = first;
+	}
+	proc = mlq_dequeue(rq, rq->prio);
+	rq->num_slot--;
+	if (rq->num_slot <= 0) {
+		rq->prio++;
+		if (rq->prio >= MAX_PRIO) rq->prio = 0;
+		rq->num_slot = MAX_PRIO - rq->prio;
 	}
-	pthread_mutex_unlock(&queue_lock);
 	return proc;
 }
 
-void put_mlq_proc(struct pcb_t * proc) {
-	pthread_mutex_lock(&queue_lock);
-	enqueue(&mlq_ready_queue[proc->prio], proc);
-	pthread_mutex_unlock(&queue_lock);
-}
+/* Take the highest priority process of the busiest other CPU.
+ * Processes the victim has not drained yet are taken first, they
+ * need no lock. The victim's MLQ slot state is left untouched. */
+static struct pcb_t * steal_mlq_proc(int cpu) {
+	struct pcb_t * proc = NULL;
+	int victim = -1, max_ready = 0;
+	int i;
 
-void add_mlq_proc(struct pcb_t * proc) {
-	pthread_mutex_lock(&queue_lock);
-	enqueue(&mlq_ready_queue[proc->prio], proc);
-	pthread_mutex_unlock(&queue_lock);	
+	for (i = 1; i < nr_cpus; i++) {
+		int other = (cpu + i) % nr_cpus;
+		int ready = atomic_load(&cpu_rq[other].nr_ready)
+			+ (int)mpmc_size(&cpu_rq[other].inbox);
+		if (ready > max_ready) {
+			max_ready = ready;
+			victim = other;
+		}
+	}
+	if (victim < 0)
+		return NULL;
+
+	struct rq_t * rq = &cpu_rq[victim];
+	if ((proc = mpmc_pop(&rq->inbox)) != NULL)
+		return proc;
+	pthread_mutex_lock(&rq->lock);
+	int first = find_first_bit(rq->mlq_bitmap, MAX_PRIO);
+	if (first < MAX_PRIO)
+		proc = mlq_dequeue(rq, first);
+	pthread_mutex_unlock(&rq->lock);
+	return proc;
 }
 
-struct pcb_t * get_proc(void) {
-	return get_mlq_proc();
+struct pcb_t * get_proc(int cpu) {
+	struct rq_t * rq = &cpu_rq[cpu];
+	struct pcb_t * proc;
+
+	pthread_mutex_lock(&rq->lock);
+	drain_inbox(rq);
+	proc = get_mlq_proc(rq);
+	pthread_mutex_unlock(&rq->lock);
+	if (proc == NULL)
+		proc = steal_mlq_proc(cpu);
+	atomic_store(&rq->running, proc != NULL);
+	return proc;
 }
 
-void put_proc(struct pcb_t * proc) {
-	return put_mlq_proc(proc);
+void put_proc(int cpu, struct pcb_t * proc) {
+	struct rq_t * rq = &cpu_rq[cpu];
+
+	pthread_mutex_lock(&rq->lock);
+	mlq_enqueue(rq, proc);
+	pthread_mutex_unlock(&rq->lock);
 }
 
+/* New processes go to the inbox of the least loaded CPU, the
+ * loader only falls back to the CPU lock when that inbox is full */
 void add_proc(struct pcb_t * proc) {
-	return add_mlq_proc(proc);
+	unsigned int start = atomic_fetch_add(&place_cursor, 1);
+	int target = 0, min_load = -1;
+	int i;
+
+	for (i = 0; i < nr_cpus; i++) {
+		int cpu = (start + i) % nr_cpus;
+		int load = rq_load(&cpu_rq[cpu]);
+		if (min_load < 0 || load < min_load) {
+			min_load = load;
+			target = cpu;
+		}
+	}
+	if (mpmc_push(&cpu_rq[target].inbox, proc))
+		put_proc(target, proc);
 }
 #else
-struct pcb_t * get_proc(void) {
+struct pcb_t * get_proc(int cpu) {
 	struct pcb_t * proc = NULL;
 	/*TODO: get a process from [ready_queue].
 	 * Remember to use lock to protect the queue.
@@ -120,7 +250,7 @@ struct pcb_t * get_proc(void) {
 	return proc;
 }
 
-void put_proc(struct pcb_t * proc) {
+void put_proc(int cpu, struct pcb_t * proc) {
 	pthread_mutex_lock(&queue_lock);
 	enqueue(&run_queue, proc);
 	pthread_mutex_unlock(&queue_lock);